@@ -85,6 +85,12 @@ public:
     return s;
   }
 
+  std::vector<uint8_t> ReadBytes(size_t len) {
+    std::vector<uint8_t> bytes(buffer.begin() + read_offset, buffer.begin() + read_offset + len);
+    read_offset += len;
+    return bytes;
+  }
+
   std::string ReadNullableString() {
     int16_t len = ReadInt16();
     if (len == -1) return "";
@@ -96,6 +102,11 @@ public:
 
   void SkipTagBuffer() {
     uint32_t num_tags = ReadUnsignedVarint();
+    for (uint32_t i = 0; i < num_tags; i++) {
+      ReadUnsignedVarint();                  // tag
+      uint32_t size = ReadUnsignedVarint();  // tag payload size
+      read_offset += size;
+    }
   }
 
   void WriteInt8(const int8_t& val) { buffer.push_back(val); }
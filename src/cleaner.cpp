@@ -0,0 +1,92 @@
+#include "cleaner.hpp"
+#include <chrono>
+#include <iostream>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int ioprio_who_process = 1;
+constexpr int ioprio_class_idle = 3;
+constexpr int ioprio_class_shift = 13;
+
+int64_t NowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void LowerThreadPriority() {
+  pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+
+  // On Linux nice values and I/O classes apply per thread
+  if (setpriority(PRIO_PROCESS, tid, 19) != 0) {
+    std::cerr << "Log cleaner: setpriority failed\n";
+  }
+  if (syscall(SYS_ioprio_set, ioprio_who_process, tid, ioprio_class_idle << ioprio_class_shift) != 0) {
+    std::cerr << "Log cleaner: ioprio_set failed\n";
+  }
+}
+
+} // namespace
+
+LogCleaner::LogCleaner(LogManager& logs, const Config& config) : logs_(logs) {
+  check_interval_ms_ = config.GetInt64("log.retention.check.interval.ms", 300000);
+  max_bytes_per_sec_ = config.GetInt64("log.cleaner.io.max.bytes.per.second", 32 * 1024 * 1024);
+}
+
+LogCleaner::~LogCleaner() {
+  Stop();
+}
+
+void LogCleaner::Start() {
+  thread_ = std::thread([this]() { run(); });
+}
+
+void LogCleaner::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) thread_.join();
+}
+
+void LogCleaner::run() {
+  LowerThreadPriority();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    lock.unlock();
+    clean_logs();
+    lock.lock();
+    cv_.wait_for(lock, std::chrono::milliseconds(check_interval_ms_), [this]() { return stopping_; });
+  }
+}
+
+void LogCleaner::clean_logs() {
+  for (auto& log : logs_.GetLogs()) {
+    // Segments are detached under the partition lock and deleted after it is released
+    std::vector<LogSegment> expired = log->CollectExpiredSegments(NowMs());
+    for (size_t i = 0; i < expired.size(); i++) {
+      LogSegment& segment = expired[i];
+      std::cerr << "Deleting segment " << segment.log_path << " (" << segment.size << " bytes), log_start_offset="
+                << log->GetLogStartOffset() << std::endl;
+      PartitionLog::DeleteSegment(segment);
+      if (!throttle(segment.size)) {
+        // Shutting down, still release whatever was detached but not deleted yet
+        for (size_t j = i + 1; j < expired.size(); j++) PartitionLog::DeleteSegment(expired[j]);
+        return;
+      }
+    }
+  }
+}
+
+// Sleeps long enough to keep deletions under max_bytes_per_sec_, returns false on shutdown
+bool LogCleaner::throttle(int64_t bytes) {
+  if (max_bytes_per_sec_ <= 0 || bytes <= 0) return true;
+
+  auto delay = std::chrono::milliseconds(bytes * 1000 / max_bytes_per_sec_);
+  std::unique_lock<std::mutex> lock(mutex_);
+  return !cv_.wait_for(lock, delay, [this]() { return stopping_; });
+}
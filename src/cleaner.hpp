@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "config.hpp"
+#include "log.hpp"
+
+// Background thread enforcing retention.ms / retention.bytes by deleting whole segments.
+// Runs at idle CPU and I/O priority and caps how many segment bytes it frees per second,
+// so deletions never compete with produce traffic.
+class LogCleaner {
+public:
+  LogCleaner(LogManager& logs, const Config& config);
+  ~LogCleaner();
+
+  void Start();
+  void Stop();
+
+private:
+  LogManager& logs_;
+  int64_t check_interval_ms_;
+  int64_t max_bytes_per_sec_;
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopping_ = false;
+
+  void run();
+  void clean_logs();
+  bool throttle(int64_t bytes);
+};
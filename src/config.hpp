@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <map>
+#include <filesystem>
+
+// Broker settings read from a Java-style server.properties file (key=value, '#' comments)
+class Config {
+public:
+  void load(std::filesystem::path path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+      std::cerr << "No broker config at " << path << ", using defaults\n";
+      return;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+      line = Trim(line);
+      if (line.empty() || line[0] == '#' || line[0] == '!') continue;
+
+      size_t sep = line.find('=');
+      if (sep == std::string::npos) continue;
+      props_[Trim(line.substr(0, sep))] = Trim(line.substr(sep + 1));
+    }
+  }
+
+  bool Has(const std::string& key) const {
+    return props_.find(key) != props_.end();
+  }
+
+  std::string GetString(const std::string& key, const std::string& fallback) const {
+    auto iter = props_.find(key);
+    return iter == props_.end() ? fallback : iter->second;
+  }
+
+  int64_t GetInt64(const std::string& key, int64_t fallback) const {
+    auto iter = props_.find(key);
+    if (iter == props_.end()) return fallback;
+    try {
+      return std::stoll(iter->second);
+    } catch (const std::exception&) {
+      std::cerr << "Invalid value for " << key << ": " << iter->second << std::endl;
+      return fallback;
+    }
+  }
+
+private:
+  std::map<std::string, std::string> props_;
+
+  static std::string Trim(const std::string& s) {
+    size_t begin = s.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) return "";
+    size_t end = s.find_last_not_of(" \t\r\n");
+    return s.substr(begin, end - begin + 1);
+  }
+};
@@ -0,0 +1,267 @@
+#include "fetcher.hpp"
+#include "server.hpp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Offset following the last batch in a chunk of record batches, or -1 if the framing is off
+int64_t NextOffsetAfter(const std::vector<uint8_t>& records) {
+  Buffer buf(reinterpret_cast<const char*>(records.data()), records.size());
+  int64_t next_offset = -1;
+  while (buf.HasBytes(batch_header_size)) {
+    size_t batch_start = buf.GetReadOffset();
+    int64_t base_offset = buf.ReadInt64();
+    int32_t batch_len = buf.ReadInt32();
+    if (batch_len < static_cast<int32_t>(batch_header_size - 12) || !buf.HasBytes(batch_len)) break;
+
+    buf.SetReadOffset(batch_start + 23);
+    int32_t last_offset_delta = buf.ReadInt32();
+    next_offset = base_offset + last_offset_delta + 1;
+    buf.SetReadOffset(batch_start + 12 + batch_len);
+  }
+  return next_offset;
+}
+
+int64_t FirstOffsetOf(const std::vector<uint8_t>& records) {
+  Buffer buf(reinterpret_cast<const char*>(records.data()), records.size());
+  return buf.ReadInt64();
+}
+
+} // namespace
+
+ReplicaFetcher::ReplicaFetcher(ReplicaManager& replicas, BrokerEndpoint leader,
+                               std::vector<std::shared_ptr<Partition>> partitions, const Config& config)
+    : replicas_(replicas), leader_(std::move(leader)), partitions_(std::move(partitions)) {
+  max_wait_ms_ = static_cast<int32_t>(config.GetInt64("replica.fetch.wait.max.ms", 500));
+  min_bytes_ = static_cast<int32_t>(config.GetInt64("replica.fetch.min.bytes", 1));
+  max_bytes_ = static_cast<int32_t>(config.GetInt64("replica.fetch.max.bytes", 1048576));
+  backoff_ms_ = config.GetInt64("replica.fetch.backoff.ms", 1000);
+}
+
+ReplicaFetcher::~ReplicaFetcher() {
+  Stop();
+}
+
+void ReplicaFetcher::Start() {
+  thread_ = std::thread([this]() { run(); });
+}
+
+void ReplicaFetcher::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+
+  // Unblocks a recv() waiting on the leader
+  int fd = fd_.load();
+  if (fd >= 0) shutdown(fd, SHUT_RDWR);
+  if (thread_.joinable()) thread_.join();
+}
+
+bool ReplicaFetcher::is_stopping() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stopping_;
+}
+
+// Sleeps for the fetch backoff, returns false if the fetcher was stopped meanwhile
+bool ReplicaFetcher::backoff() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return !cv_.wait_for(lock, std::chrono::milliseconds(backoff_ms_), [this]() { return stopping_; });
+}
+
+void ReplicaFetcher::run() {
+  while (!is_stopping()) {
+    int fd = Server::connectTo(leader_.host, leader_.port);
+    if (fd < 0) {
+      if (!backoff()) break;
+      continue;
+    }
+
+    fd_ = fd;
+    if (is_stopping()) shutdown(fd, SHUT_RDWR); // Stop() may have missed the fd
+    std::cerr << "Replica fetcher connected to broker " << leader_.node_id << std::endl;
+
+    fetch_loop(fd);
+
+    fd_ = -1;
+    close(fd);
+    if (!is_stopping()) {
+      std::cerr << "Lost connection to broker " << leader_.node_id << ", reconnecting\n";
+      if (!backoff()) break;
+    }
+  }
+}
+
+void ReplicaFetcher::fetch_loop(int fd) {
+  std::vector<int64_t> offsets;
+  for (auto& partition : partitions_) offsets.push_back(partition->log->GetLogEndOffset());
+  if (!send_fetch(fd, offsets)) return;
+
+  std::vector<PartitionData> responses;
+  while (!is_stopping()) {
+    if (!receive_response(fd, responses)) return;
+
+    // Every earlier response is already appended, so the local log end is where each
+    // partition continues unless this response carries the next records for it
+    bool pipelined = true;
+    for (size_t i = 0; i < partitions_.size(); i++) {
+      const PartitionData& data = responses[i];
+      offsets[i] = partitions_[i]->log->GetLogEndOffset();
+      if (data.error_code != 0) {
+        pipelined = false;
+      } else if (!data.records.empty() && FirstOffsetOf(data.records) == offsets[i]) {
+        offsets[i] = std::max(offsets[i], NextOffsetAfter(data.records));
+      }
+    }
+
+    // Get the next fetch on the wire before touching the disk
+    if (pipelined && !send_fetch(fd, offsets)) return;
+
+    bool needs_backoff = false;
+    for (size_t i = 0; i < partitions_.size(); i++) {
+      Partition& partition = *partitions_[i];
+      PartitionData& data = responses[i];
+
+      if (data.error_code == 0) {
+        if (!data.records.empty() && FirstOffsetOf(data.records) != partition.log->GetLogEndOffset()) {
+          data.records.clear(); // answer to a request made before a resync, fetched again below
+        }
+        if (replicas_.AppendAsFollower(partition, data.records, data.high_watermark) < 0) {
+          offsets[i] = partition.log->GetLogEndOffset();
+          needs_backoff = true;
+        }
+      } else if (data.error_code == 1) { // OFFSET_OUT_OF_RANGE
+        replicas_.HandleOffsetOutOfRange(partition, data.log_start_offset, data.high_watermark);
+        offsets[i] = partition.log->GetLogEndOffset();
+      } else {
+        std::cerr << "Fetch of " << partition.topic << "-" << partition.partition_id << " from broker "
+                  << leader_.node_id << " failed with error " << data.error_code << std::endl;
+        needs_backoff = true;
+      }
+    }
+
+    if (needs_backoff && !backoff()) return;
+    if (!pipelined && !send_fetch(fd, offsets)) return;
+  }
+}
+
+bool ReplicaFetcher::send_fetch(int fd, const std::vector<int64_t>& offsets) {
+  Buffer req;
+  req.WriteInt32(0); // message_size
+  req.WriteInt16(api_fetch_key);
+  req.WriteInt16(api_fetch_version);
+  req.WriteInt32(++correlation_id_);
+  std::string client_id = "replica-" + std::to_string(replicas_.GetNodeId());
+  req.WriteInt16(static_cast<int16_t>(client_id.size()));
+  req.writeBytes(std::vector<uint8_t>(client_id.begin(), client_id.end()));
+  req.writeTagBuffer();
+
+  req.WriteInt32(replicas_.GetNodeId()); // replica_id
+  req.WriteInt32(max_wait_ms_);
+  req.WriteInt32(min_bytes_);
+  req.WriteInt32(max_bytes_);
+  req.WriteInt8(0);   // isolation_level
+  req.WriteInt32(0);  // session_id
+  req.WriteInt32(-1); // session_epoch, -1 = no fetch session
+
+  // One topic entry per partition keeps the response order identical to partitions_
+  req.writeCompactArrayLength(static_cast<int>(partitions_.size()));
+  for (size_t i = 0; i < partitions_.size(); i++) {
+    const Partition& partition = *partitions_[i];
+    req.writeCompactString(partition.topic);
+    req.writeCompactArrayLength(1);
+    req.WriteInt32(partition.partition_id);
+    req.WriteInt32(partition.leader_epoch); // current_leader_epoch
+    req.WriteInt64(offsets[i]);             // fetch_offset
+    req.WriteInt32(-1);                     // last_fetched_epoch
+    req.WriteInt64(-1);                     // log_start_offset
+    req.WriteInt32(max_bytes_);             // partition_max_bytes
+    req.writeTagBuffer();
+    req.writeTagBuffer();
+  }
+  req.writeCompactArrayLength(0); // forgotten_topics_data
+  req.writeCompactString("");     // rack_id
+  req.writeTagBuffer();
+
+  int32_t request_size = htonl(req.GetSize() - 4);
+  std::memcpy(req.GetData().data(), &request_size, 4);
+
+  const uint8_t* data = req.GetData().data();
+  size_t remaining = req.GetSize();
+  while (remaining > 0) {
+    ssize_t n = send(fd, data, remaining, MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    data += n;
+    remaining -= n;
+  }
+  return true;
+}
+
+bool ReplicaFetcher::receive_response(int fd, std::vector<PartitionData>& out) {
+  int32_t message_size_be;
+  if (recv(fd, &message_size_be, 4, MSG_WAITALL) != 4) return false;
+  int32_t message_size = ntohl(message_size_be);
+  if (message_size <= 0) return false;
+
+  std::vector<char> raw_buffer(message_size);
+  if (recv(fd, raw_buffer.data(), message_size, MSG_WAITALL) != message_size) return false;
+  Buffer res(raw_buffer.data(), raw_buffer.size());
+
+  int32_t correlation_id = res.ReadInt32();
+  if (correlation_id != correlation_id_) {
+    std::cerr << "Unexpected correlation id " << correlation_id << " from broker " << leader_.node_id << std::endl;
+    return false;
+  }
+  res.SkipTagBuffer();
+
+  res.ReadInt32();                    // throttle_time_ms
+  int16_t error_code = res.ReadInt16();
+  res.ReadInt32();                    // session_id
+  if (error_code != 0) {
+    std::cerr << "Fetch from broker " << leader_.node_id << " failed with error " << error_code << std::endl;
+    return false;
+  }
+
+  out.assign(partitions_.size(), PartitionData {});
+  uint32_t topic_len = res.ReadUnsignedVarint();
+  uint32_t num_topics = topic_len > 0 ? topic_len - 1 : 0;
+  for (uint32_t t = 0; t < num_topics; t++) {
+    std::string topic = res.ReadCompactString();
+    uint32_t partition_len = res.ReadUnsignedVarint();
+    uint32_t num_partitions = partition_len > 0 ? partition_len - 1 : 0;
+
+    for (uint32_t p = 0; p < num_partitions; p++) {
+      PartitionData data;
+      int32_t partition_id  = res.ReadInt32();
+      data.error_code       = res.ReadInt16();
+      data.high_watermark   = res.ReadInt64();
+      res.ReadInt64();      // last_stable_offset
+      data.log_start_offset = res.ReadInt64();
+
+      uint32_t aborted_len = res.ReadUnsignedVarint();
+      uint32_t num_aborted = aborted_len > 0 ? aborted_len - 1 : 0;
+      for (uint32_t a = 0; a < num_aborted; a++) {
+        res.ReadInt64(); // producer_id
+        res.ReadInt64(); // first_offset
+        res.SkipTagBuffer();
+      }
+      res.ReadInt32(); // preferred_read_replica
+
+      uint32_t records_len = res.ReadUnsignedVarint();
+      if (records_len > 1) data.records = res.ReadBytes(records_len - 1);
+      res.SkipTagBuffer();
+
+      for (size_t i = 0; i < partitions_.size(); i++) {
+        if (partitions_[i]->topic == topic && partitions_[i]->partition_id == partition_id) {
+          out[i] = std::move(data);
+          break;
+        }
+      }
+    }
+    res.SkipTagBuffer();
+  }
+  return true;
+}
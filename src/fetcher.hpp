@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "buffer.hpp"
+#include "config.hpp"
+#include "replica.hpp"
+
+// Follower side of replication: pulls every partition this broker follows from one leader
+// over a single connection using Fetch v12 requests carrying our replica_id.
+//
+// Fetches are pipelined: as soon as a response is parsed the next request goes out with
+// the offsets that response ends at, and the records are appended to the local log while
+// the leader is already serving it. A request therefore only vouches for the offsets of the
+// one before it on this connection, which is what the leader credits as our log end.
+// Appends only reach the page cache and start write-back without waiting for it.
+class ReplicaFetcher {
+public:
+  ReplicaFetcher(ReplicaManager& replicas, BrokerEndpoint leader,
+                 std::vector<std::shared_ptr<Partition>> partitions, const Config& config);
+  ~ReplicaFetcher();
+
+  void Start();
+  void Stop();
+
+private:
+  struct PartitionData {
+    int16_t error_code = -1;
+    int64_t high_watermark = -1;
+    int64_t log_start_offset = -1;
+    std::vector<uint8_t> records;
+  };
+
+  ReplicaManager& replicas_;
+  BrokerEndpoint leader_;
+  std::vector<std::shared_ptr<Partition>> partitions_;
+
+  int32_t max_wait_ms_;
+  int32_t min_bytes_;
+  int32_t max_bytes_;
+  int64_t backoff_ms_;
+
+  const int16_t api_fetch_key = 1;
+  const int16_t api_fetch_version = 12;
+  int32_t correlation_id_ = 0;
+
+  std::thread thread_;
+  std::atomic<int> fd_ {-1};
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopping_ = false;
+
+  void run();
+  void fetch_loop(int fd);
+  bool send_fetch(int fd, const std::vector<int64_t>& offsets);
+  bool receive_response(int fd, std::vector<PartitionData>& out);
+  bool backoff();
+  bool is_stopping();
+};
@@ -0,0 +1,813 @@
+#include "log.hpp"
+#include "crc32c.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+std::string SegmentFileName(int64_t base_offset, const char* suffix) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%020lld%s", static_cast<long long>(base_offset), suffix);
+  return name;
+}
+
+int64_t ReadBigEndian64(const uint8_t* b) {
+  uint64_t v = 0;
+  for (int i = 0; i < 8; i++) v = (v << 8) | b[i];
+  return static_cast<int64_t>(v);
+}
+
+int32_t ReadBigEndian32(const uint8_t* b) {
+  return static_cast<int32_t>(
+      (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 8 | (uint32_t)b[3]);
+}
+
+void WriteBigEndian64(uint8_t* b, int64_t val) {
+  uint64_t u = static_cast<uint64_t>(val);
+  for (int i = 7; i >= 0; i--) {
+    b[i] = static_cast<uint8_t>(u);
+    u >>= 8;
+  }
+}
+
+void WriteBigEndian32(uint8_t* b, int32_t val) {
+  uint32_t u = static_cast<uint32_t>(val);
+  for (int i = 3; i >= 0; i--) {
+    b[i] = static_cast<uint8_t>(u);
+    u >>= 8;
+  }
+}
+
+bool WriteFully(int fd, const uint8_t* data, size_t len, int64_t position) {
+  while (len > 0) {
+    ssize_t n = pwrite(fd, data, len, position);
+    if (n <= 0) return false;
+    data += n;
+    len -= n;
+    position += n;
+  }
+  return true;
+}
+
+int64_t ParseInt64(const std::map<std::string, std::string>& props, const std::string& key, int64_t fallback) {
+  auto iter = props.find(key);
+  if (iter == props.end()) return fallback;
+  try {
+    return std::stoll(iter->second);
+  } catch (const std::exception&) {
+    std::cerr << "Invalid topic config " << key << "=" << iter->second << std::endl;
+    return fallback;
+  }
+}
+
+constexpr const char* clean_shutdown_file = ".kafka_cleanshutdown";
+constexpr const char* recovery_point_file = "recovery-point-offset-checkpoint";
+
+} // namespace
+
+PartitionLog::PartitionLog(std::filesystem::path dir, LogConfig config)
+    : dir_(std::move(dir)), config_(config) {}
+
+PartitionLog::~PartitionLog() {
+  for (auto& segment : segments_) {
+    if (segment.log_fd >= 0) close(segment.log_fd);
+    if (segment.index_fd >= 0) close(segment.index_fd);
+  }
+}
+
+bool PartitionLog::Load(int64_t recovery_point, bool clean_shutdown) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  std::error_code ec;
+  std::filesystem::create_directories(dir_, ec);
+  if (ec) {
+    std::cerr << "Failed to create log dir " << dir_ << ": " << ec.message() << std::endl;
+    return false;
+  }
+
+  std::vector<int64_t> base_offsets;
+  for (const auto& entry : std::filesystem::directory_iterator(dir_)) {
+    if (entry.path().extension() != ".log") continue;
+    try {
+      base_offsets.push_back(std::stoll(entry.path().stem().string()));
+    } catch (const std::exception&) {
+      std::cerr << "Skipping unexpected file " << entry.path() << std::endl;
+    }
+  }
+  std::sort(base_offsets.begin(), base_offsets.end());
+
+  for (size_t i = 0; i < base_offsets.size(); i++) {
+    const bool is_last = i + 1 == base_offsets.size();
+    // Every offset in the segment precedes the recovery point, so it was flushed
+    const bool trusted = clean_shutdown || (!is_last && base_offsets[i + 1] <= recovery_point);
+
+    if (!open_segment(base_offsets[i], !trusted)) return false;
+    LogSegment& segment = segments_.back();
+
+    if (trusted && !is_last) {
+      segment.next_offset = base_offsets[i + 1];
+    } else if (trusted) {
+      // Only the batches after the last index entry need scanning to find the log end
+      recover_segment(segment, last_indexed_position(segment), false);
+    } else {
+      bool intact = recover_segment(segment, 0, true);
+      fdatasync(segment.log_fd);
+      fdatasync(segment.index_fd);
+      if (intact) continue;
+
+      // Everything after a torn or corrupt batch is unreachable, drop the later segments
+      for (size_t j = i + 1; j < base_offsets.size(); j++) {
+        std::cerr << "Deleting segment " << base_offsets[j] << " after corrupt data in " << dir_ << std::endl;
+        std::filesystem::remove(dir_ / SegmentFileName(base_offsets[j], ".log"), ec);
+        std::filesystem::remove(dir_ / SegmentFileName(base_offsets[j], ".index"), ec);
+      }
+      break;
+    }
+  }
+
+  if (segments_.empty() && !open_segment(0, true)) return false;
+  recovery_point_ = segments_.back().next_offset;
+  return true;
+}
+
+bool PartitionLog::open_segment(int64_t base_offset, bool truncate_index) {
+  LogSegment segment;
+  segment.base_offset = base_offset;
+  segment.next_offset = base_offset;
+  segment.log_path    = dir_ / SegmentFileName(base_offset, ".log");
+  segment.index_path  = dir_ / SegmentFileName(base_offset, ".index");
+
+  segment.log_fd = open(segment.log_path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (segment.log_fd < 0) {
+    std::cerr << "Failed to open segment " << segment.log_path << std::endl;
+    return false;
+  }
+
+  int index_flags = O_RDWR | O_CREAT | O_APPEND | (truncate_index ? O_TRUNC : 0);
+  segment.index_fd = open(segment.index_path.c_str(), index_flags, 0644);
+  if (segment.index_fd < 0) {
+    close(segment.log_fd);
+    std::cerr << "Failed to open index " << segment.index_path << std::endl;
+    return false;
+  }
+
+  segment.size = lseek(segment.log_fd, 0, SEEK_END);
+  segments_.push_back(std::move(segment));
+  return true;
+}
+
+bool PartitionLog::roll_segment() {
+  int64_t next_offset = segments_.back().next_offset;
+  std::cerr << "Rolling new segment at offset " << next_offset << " in " << dir_ << std::endl;
+  return open_segment(next_offset, true);
+}
+
+// Scans batches from start_position, rebuilding index entries past it, and truncates the
+// segment at the first batch with broken framing (or a bad CRC when validate_crc is set).
+// Returns false if anything had to be truncated.
+bool PartitionLog::recover_segment(LogSegment& segment, int64_t start_position, bool validate_crc) {
+  const int64_t file_size = segment.size;
+  int64_t position = start_position;
+  uint8_t header[batch_header_size];
+  std::vector<uint8_t> batch;
+
+  segment.bytes_since_index = 0;
+  while (position + 12 <= file_size) {
+    if (pread(segment.log_fd, header, batch_header_size, position) != static_cast<ssize_t>(batch_header_size)) break;
+
+    int64_t base_offset = ReadBigEndian64(header);
+    int32_t batch_len   = ReadBigEndian32(header + 8);
+
+    // batch_len covers everything after the first 12 bytes (base_offset + batch_len)
+    int64_t batch_size = 12 + static_cast<int64_t>(batch_len);
+    if (batch_len < static_cast<int32_t>(batch_header_size - 12) || position + batch_size > file_size) break;
+    if (header[16] != 2) break; // magic
+
+    if (validate_crc) {
+      // CRC covers attributes through the end of the batch
+      batch.resize(batch_size);
+      if (pread(segment.log_fd, batch.data(), batch_size, position) != batch_size) break;
+      uint32_t crc = static_cast<uint32_t>(ReadBigEndian32(&batch[17]));
+      if (Crc32c(&batch[21], batch_size - 21) != crc) {
+        std::cerr << "CRC mismatch at offset " << base_offset << " in " << segment.log_path << std::endl;
+        break;
+      }
+    }
+
+    int32_t last_offset_delta = ReadBigEndian32(header + 23);
+    int64_t max_timestamp     = ReadBigEndian64(header + 35);
+
+    if (segment.bytes_since_index >= config_.index_interval_bytes) {
+      append_index_entry(segment, base_offset, position);
+      segment.bytes_since_index = 0;
+    }
+    segment.bytes_since_index += batch_size;
+    segment.max_timestamp = std::max(segment.max_timestamp, max_timestamp);
+    segment.next_offset   = base_offset + last_offset_delta + 1;
+    position += batch_size;
+  }
+
+  segment.size = position;
+  if (position == file_size) return true;
+
+  std::cerr << "Truncating " << (file_size - position) << " trailing bytes from "
+            << segment.log_path << std::endl;
+  if (ftruncate(segment.log_fd, position) != 0) {
+    std::cerr << "ftruncate failed for " << segment.log_path << std::endl;
+  }
+  return false;
+}
+
+// File position of the last batch recorded in the index, 0 if the index is empty or stale
+int64_t PartitionLog::last_indexed_position(LogSegment& segment) {
+  int64_t entries = lseek(segment.index_fd, 0, SEEK_END) / 8;
+  if (entries <= 0) return 0;
+
+  uint8_t entry[8];
+  if (pread(segment.index_fd, entry, sizeof(entry), (entries - 1) * 8) != static_cast<ssize_t>(sizeof(entry))) return 0;
+
+  int64_t offset = segment.base_offset + ReadBigEndian32(entry);
+  int64_t position = ReadBigEndian32(entry + 4);
+  if (position < 0 || position >= segment.size) return 0;
+
+  segment.next_offset = offset;
+  return position;
+}
+
+void PartitionLog::append_index_entry(LogSegment& segment, int64_t offset, int64_t position) {
+  // Entry layout matches Kafka's .index: relative offset (int32) + file position (int32)
+  uint8_t entry[8];
+  WriteBigEndian32(entry, static_cast<int32_t>(offset - segment.base_offset));
+  WriteBigEndian32(entry + 4, static_cast<int32_t>(position));
+  if (write(segment.index_fd, entry, sizeof(entry)) != static_cast<ssize_t>(sizeof(entry))) {
+    std::cerr << "Failed to write index entry to " << segment.index_path << std::endl;
+  }
+}
+
+int64_t PartitionLog::Append(std::vector<uint8_t>& batches) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (closed_) return -1;
+  const int64_t first_offset = segments_.back().next_offset;
+  int64_t log_end_offset = append_batches(batches, true);
+  return log_end_offset < 0 ? log_end_offset : first_offset;
+}
+
+int64_t PartitionLog::AppendAsFollower(std::vector<uint8_t>& batches) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (closed_) return -1;
+  int64_t log_end_offset = append_batches(batches, false);
+  if (log_end_offset >= 0 && !batches.empty()) {
+    // Kick off write-back without waiting for it, so the next Flush() has little left to sync
+    const LogSegment& active = segments_.back();
+    sync_file_range(active.log_fd, active.size - static_cast<int64_t>(batches.size()), batches.size(),
+                    SYNC_FILE_RANGE_WRITE);
+  }
+  return log_end_offset;
+}
+
+// Writes the batches to the active segment and returns the new log end offset. With
+// assign_offsets the batches are renumbered from the log end, otherwise their offsets
+// must continue it exactly.
+int64_t PartitionLog::append_batches(std::vector<uint8_t>& batches, bool assign_offsets) {
+  // Validate every batch the way recovery will before assigning any offsets: a batch that
+  // recovery rejects would take every later batch in the segment down with it
+  size_t position = 0;
+  int64_t expected_offset = segments_.back().next_offset;
+  while (position < batches.size()) {
+    if (position + batch_header_size > batches.size()) return invalid_batch;
+    int32_t batch_len = ReadBigEndian32(&batches[position + 8]);
+    if (batch_len < static_cast<int32_t>(batch_header_size - 12)) return invalid_batch;
+    if (position + 12 + static_cast<size_t>(batch_len) > batches.size()) return invalid_batch;
+    if (batches[position + 16] != 2) return invalid_batch; // magic
+
+    uint32_t crc = static_cast<uint32_t>(ReadBigEndian32(&batches[position + 17]));
+    if (Crc32c(&batches[position + 21], 12 + static_cast<size_t>(batch_len) - 21) != crc) {
+      std::cerr << "Rejecting batch with CRC mismatch for " << dir_ << std::endl;
+      return invalid_batch;
+    }
+
+    if (!assign_offsets && ReadBigEndian64(&batches[position]) != expected_offset) {
+      std::cerr << "Replicated batch at offset " << ReadBigEndian64(&batches[position])
+                << " does not continue " << dir_ << " at " << expected_offset << std::endl;
+      return -1;
+    }
+    expected_offset = ReadBigEndian64(&batches[position]) + ReadBigEndian32(&batches[position + 23]) + 1;
+    position += 12 + static_cast<size_t>(batch_len);
+  }
+
+  LogSegment* active = &segments_.back();
+  if (batches.empty()) return active->next_offset;
+
+  if (active->size > 0 && active->size + static_cast<int64_t>(batches.size()) > config_.segment_bytes) {
+    if (!roll_segment()) return -1;
+    active = &segments_.back();
+  }
+
+  int64_t offset = active->next_offset;
+  int64_t max_timestamp = active->max_timestamp;
+  int64_t bytes_since_index = active->bytes_since_index;
+
+  position = 0;
+  while (position < batches.size()) {
+    uint8_t* batch = &batches[position];
+    int32_t batch_len = ReadBigEndian32(batch + 8);
+    int64_t batch_size = 12 + static_cast<int64_t>(batch_len);
+
+    // base_offset sits outside the CRC-covered region, so rewriting it keeps the batch valid
+    if (assign_offsets) WriteBigEndian64(batch, offset);
+
+    if (bytes_since_index >= config_.index_interval_bytes) {
+      append_index_entry(*active, offset, active->size + position);
+      bytes_since_index = 0;
+    }
+    bytes_since_index += batch_size;
+    max_timestamp = std::max(max_timestamp, ReadBigEndian64(batch + 35));
+
+    offset += ReadBigEndian32(batch + 23) + 1; // last_offset_delta + 1
+    position += batch_size;
+  }
+
+  if (!WriteFully(active->log_fd, batches.data(), batches.size(), active->size)) {
+    std::cerr << "Failed to append to " << active->log_path << std::endl;
+    if (ftruncate(active->log_fd, active->size) != 0) {
+      std::cerr << "ftruncate failed for " << active->log_path << std::endl;
+    }
+    return -1;
+  }
+
+  active->size += batches.size();
+  active->next_offset = offset;
+  active->max_timestamp = max_timestamp;
+  active->bytes_since_index = bytes_since_index;
+  return offset;
+}
+
+int64_t PartitionLog::Flush() {
+  std::vector<int> fds;
+  int64_t log_end_offset;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    log_end_offset = segments_.back().next_offset;
+    if (log_end_offset == recovery_point_) return recovery_point_;
+
+    // dup() so a concurrent segment deletion can't close the fds mid-sync
+    for (const auto& segment : segments_) {
+      if (segment.next_offset <= recovery_point_) continue;
+      fds.push_back(dup(segment.log_fd));
+      fds.push_back(dup(segment.index_fd));
+    }
+  }
+
+  // Sync outside the lock so appends aren't stalled behind the disk
+  bool synced = true;
+  for (int fd : fds) {
+    if (fd < 0 || fdatasync(fd) != 0) synced = false;
+    if (fd >= 0) close(fd);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!synced) {
+    std::cerr << "Failed to flush " << dir_ << std::endl;
+    return -1;
+  }
+  recovery_point_ = std::max(recovery_point_, log_end_offset);
+  return recovery_point_;
+}
+
+void PartitionLog::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  closed_ = true;
+}
+
+// File position of the last indexed batch starting at or before offset
+int64_t PartitionLog::lookup_position(const LogSegment& segment, int64_t offset) const {
+  int64_t entries = lseek(segment.index_fd, 0, SEEK_END) / 8;
+  if (entries <= 0) return 0;
+
+  std::vector<uint8_t> index(entries * 8);
+  if (pread(segment.index_fd, index.data(), index.size(), 0) != static_cast<ssize_t>(index.size())) return 0;
+
+  // Entries are sorted by relative offset, binary search for the last one <= offset
+  int64_t low = 0, high = entries - 1, position = 0;
+  while (low <= high) {
+    int64_t mid = (low + high) / 2;
+    if (segment.base_offset + ReadBigEndian32(&index[mid * 8]) <= offset) {
+      position = ReadBigEndian32(&index[mid * 8 + 4]);
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return position;
+}
+
+std::vector<uint8_t> PartitionLog::Read(int64_t offset, int64_t max_offset, int32_t max_bytes) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<uint8_t> data;
+  if (offset < segments_.front().base_offset || offset >= max_offset) return data;
+
+  // Last segment whose base offset is <= offset
+  auto segment = std::upper_bound(segments_.begin(), segments_.end(), offset,
+      [](int64_t value, const LogSegment& s) { return value < s.base_offset; });
+  --segment;
+
+  uint8_t header[batch_header_size];
+  int64_t position = lookup_position(*segment, offset);
+  for (; segment != segments_.end(); ++segment, position = 0) {
+    int64_t start = -1;
+    int64_t end = position;
+    bool full = false;
+
+    while (end + static_cast<int64_t>(batch_header_size) <= segment->size) {
+      if (pread(segment->log_fd, header, batch_header_size, end) != static_cast<ssize_t>(batch_header_size)) break;
+
+      int64_t batch_size = 12 + static_cast<int64_t>(ReadBigEndian32(header + 8));
+      int64_t next_offset = ReadBigEndian64(header) + ReadBigEndian32(header + 23) + 1;
+      if (next_offset <= offset) {
+        end += batch_size; // batch lies entirely before the requested offset
+        continue;
+      }
+      if (start < 0) start = end;
+
+      // Always hand out at least one batch, even if it exceeds max_bytes
+      int64_t total = static_cast<int64_t>(data.size()) + (end - start) + batch_size;
+      if (next_offset > max_offset || (total > max_bytes && total != batch_size)) {
+        full = true;
+        break;
+      }
+      end += batch_size;
+    }
+
+    if (start >= 0 && end > start) {
+      size_t old_size = data.size();
+      data.resize(old_size + (end - start));
+      if (pread(segment->log_fd, data.data() + old_size, end - start, start) != end - start) {
+        data.resize(old_size);
+        break;
+      }
+    }
+    if (full) break;
+  }
+  return data;
+}
+
+bool PartitionLog::TruncateTo(int64_t offset) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (closed_) return false;
+  if (offset >= segments_.back().next_offset) return true;
+
+  while (segments_.size() > 1 && segments_.back().base_offset >= offset) {
+    DeleteSegment(segments_.back());
+    segments_.pop_back();
+  }
+
+  LogSegment& segment = segments_.back();
+  if (segment.base_offset >= offset) {
+    // Nothing below offset is left; keep the segment file but empty it
+    segment.size = 0;
+    segment.next_offset = segment.base_offset;
+  }
+
+  // Find the first batch boundary at or past offset
+  uint8_t header[batch_header_size];
+  int64_t position = lookup_position(segment, offset - 1);
+  int64_t next_offset = segment.base_offset;
+  while (position + static_cast<int64_t>(batch_header_size) <= segment.size) {
+    if (pread(segment.log_fd, header, batch_header_size, position) != static_cast<ssize_t>(batch_header_size)) return false;
+    if (ReadBigEndian64(header) >= offset) break;
+    next_offset = ReadBigEndian64(header) + ReadBigEndian32(header + 23) + 1;
+    position += 12 + static_cast<int64_t>(ReadBigEndian32(header + 8));
+  }
+
+  std::cerr << "Truncating " << dir_ << " to offset " << next_offset << std::endl;
+  if (ftruncate(segment.log_fd, position) != 0) return false;
+  segment.size = position;
+  segment.next_offset = next_offset;
+
+  // Drop index entries pointing at or past the new end
+  int64_t entries = lseek(segment.index_fd, 0, SEEK_END) / 8;
+  uint8_t entry[8];
+  while (entries > 0 && pread(segment.index_fd, entry, sizeof(entry), (entries - 1) * 8) == sizeof(entry) &&
+         ReadBigEndian32(entry + 4) >= position) {
+    entries--;
+  }
+  if (ftruncate(segment.index_fd, entries * 8) != 0) return false;
+  segment.bytes_since_index = entries > 0 ? position - ReadBigEndian32(entry + 4) : position;
+
+  recovery_point_ = std::min(recovery_point_, next_offset);
+  return true;
+}
+
+bool PartitionLog::TruncateFullyAndStartAt(int64_t offset) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (closed_) return false;
+  std::cerr << "Resetting " << dir_ << " to start at offset " << offset << std::endl;
+
+  for (auto& segment : segments_) DeleteSegment(segment);
+  segments_.clear();
+  recovery_point_ = offset;
+  return open_segment(offset, true);
+}
+
+std::vector<LogSegment> PartitionLog::CollectExpiredSegments(int64_t now_ms) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<LogSegment> expired;
+
+  auto is_time_expired = [&](const LogSegment& segment) {
+    if (config_.retention_ms < 0 || segment.size == 0) return false;
+    int64_t timestamp = segment.max_timestamp;
+    if (timestamp < 0) {
+      // No usable batch timestamps, fall back to the file's modification time
+      struct stat st {};
+      if (fstat(segment.log_fd, &st) != 0) return false;
+      timestamp = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000 + st.st_mtim.tv_nsec / 1000000;
+    }
+    return timestamp < now_ms - config_.retention_ms;
+  };
+
+  // When every segment has expired, roll so the active segment can go too
+  if (is_time_expired(segments_.back())) {
+    bool all_expired = std::all_of(segments_.begin(), segments_.end(), is_time_expired);
+    if (all_expired && !roll_segment()) return expired;
+  }
+
+  while (segments_.size() > 1 && is_time_expired(segments_.front())) {
+    expired.push_back(std::move(segments_.front()));
+    segments_.erase(segments_.begin());
+  }
+
+  if (config_.retention_bytes >= 0) {
+    int64_t total = 0;
+    for (const auto& segment : segments_) total += segment.size;
+
+    // The active segment is never removed for size, it keeps growing until it rolls
+    while (segments_.size() > 1 && total - segments_.front().size >= config_.retention_bytes) {
+      total -= segments_.front().size;
+      expired.push_back(std::move(segments_.front()));
+      segments_.erase(segments_.begin());
+    }
+  }
+
+  return expired;
+}
+
+void PartitionLog::DeleteSegment(LogSegment& segment) {
+  if (segment.log_fd >= 0) close(segment.log_fd);
+  if (segment.index_fd >= 0) close(segment.index_fd);
+  segment.log_fd = -1;
+  segment.index_fd = -1;
+
+  std::error_code ec;
+  std::filesystem::remove(segment.log_path, ec);
+  if (ec) std::cerr << "Failed to delete " << segment.log_path << ": " << ec.message() << std::endl;
+  std::filesystem::remove(segment.index_path, ec);
+  if (ec) std::cerr << "Failed to delete " << segment.index_path << ": " << ec.message() << std::endl;
+}
+
+int64_t PartitionLog::GetLogStartOffset() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return segments_.front().base_offset;
+}
+
+int64_t PartitionLog::GetRecoveryPoint() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return recovery_point_;
+}
+
+int64_t PartitionLog::GetLogEndOffset() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return segments_.back().next_offset;
+}
+
+LogManager::LogManager(std::filesystem::path log_dir, const Config& config, const Metadata& metadata)
+    : log_dir_(std::move(log_dir)), metadata_(metadata) {
+
+  defaults_.segment_bytes = config.GetInt64("log.segment.bytes", defaults_.segment_bytes);
+  defaults_.retention_bytes = config.GetInt64("log.retention.bytes", defaults_.retention_bytes);
+  defaults_.index_interval_bytes = config.GetInt64("log.index.interval.bytes", defaults_.index_interval_bytes);
+
+  unsigned int cores = std::thread::hardware_concurrency();
+  recovery_threads_ = config.GetInt64("num.recovery.threads.per.data.dir", cores > 0 ? cores : 1);
+  checkpoint_interval_ms_ = config.GetInt64("log.flush.offset.checkpoint.interval.ms", 60000);
+
+  // Same precedence as Kafka: ms, then minutes, then hours
+  if (config.Has("log.retention.ms")) {
+    defaults_.retention_ms = config.GetInt64("log.retention.ms", defaults_.retention_ms);
+  } else if (config.Has("log.retention.minutes")) {
+    defaults_.retention_ms = config.GetInt64("log.retention.minutes", 0) * 60 * 1000;
+  } else if (config.Has("log.retention.hours")) {
+    defaults_.retention_ms = config.GetInt64("log.retention.hours", 0) * 60 * 60 * 1000;
+  }
+}
+
+LogConfig LogManager::resolve_config(const std::string& topic) const {
+  LogConfig config = defaults_;
+  std::map<std::string, std::string> overrides = metadata_.GetTopicConfig(topic);
+  config.segment_bytes = ParseInt64(overrides, "segment.bytes", config.segment_bytes);
+  config.retention_ms = ParseInt64(overrides, "retention.ms", config.retention_ms);
+  config.retention_bytes = ParseInt64(overrides, "retention.bytes", config.retention_bytes);
+  config.index_interval_bytes = ParseInt64(overrides, "index.interval.bytes", config.index_interval_bytes);
+  return config;
+}
+
+void LogManager::LoadLogs() {
+  std::error_code ec;
+  if (!std::filesystem::is_directory(log_dir_, ec)) return;
+
+  auto start = std::chrono::steady_clock::now();
+  const std::filesystem::path marker = log_dir_ / clean_shutdown_file;
+  const bool clean_shutdown = std::filesystem::exists(marker, ec);
+  const std::map<std::string, int64_t> recovery_points = read_recovery_points();
+
+  // A crash from here on must not be mistaken for a clean shutdown
+  std::filesystem::remove(marker, ec);
+
+  std::vector<std::pair<std::string, int32_t>> partitions;
+  for (const auto& entry : std::filesystem::directory_iterator(log_dir_)) {
+    if (!entry.is_directory()) continue;
+
+    // Partition directories are named <topic>-<partition>
+    std::string name = entry.path().filename().string();
+    size_t dash = name.rfind('-');
+    if (dash == std::string::npos || dash + 1 == name.size()) continue;
+
+    std::string topic = name.substr(0, dash);
+    std::string partition = name.substr(dash + 1);
+    if (!std::all_of(partition.begin(), partition.end(), ::isdigit)) continue;
+    if (!metadata_.IsTopicAvailable(topic)) continue;
+
+    partitions.emplace_back(topic, std::stoi(partition));
+  }
+
+  // Partitions recover independently, so spread them over a small pool
+  std::atomic<size_t> next_partition {0};
+  auto recover = [&]() {
+    for (size_t i = next_partition++; i < partitions.size(); i = next_partition++) {
+      const auto& [topic, partition] = partitions[i];
+      std::string key = topic + "-" + std::to_string(partition);
+      auto iter = recovery_points.find(key);
+      int64_t recovery_point = iter == recovery_points.end() ? 0 : iter->second;
+
+      auto log = open_log(topic, partition, recovery_point, clean_shutdown);
+      if (!log) continue;
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      logs_[key] = log;
+    }
+  };
+
+  size_t num_threads = std::clamp<size_t>(recovery_threads_, 1, std::max<size_t>(partitions.size(), 1));
+  std::vector<std::thread> pool;
+  for (size_t t = 0; t < num_threads; t++) pool.emplace_back(recover);
+  for (auto& thread : pool) thread.join();
+
+  auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  std::cerr << "Loaded " << logs_.size() << " logs in " << elapsed_ms << " ms with " << num_threads
+            << " recovery threads after " << (clean_shutdown ? "clean" : "unclean") << " shutdown" << std::endl;
+}
+
+void LogManager::Start() {
+  checkpoint_thread_ = std::thread([this]() {
+    std::unique_lock<std::mutex> lock(checkpoint_mutex_);
+    while (!checkpoint_cv_.wait_for(lock, std::chrono::milliseconds(checkpoint_interval_ms_),
+                                    [this]() { return stopping_; })) {
+      lock.unlock();
+      checkpoint_recovery_points();
+      lock.lock();
+    }
+  });
+}
+
+void LogManager::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+    stopping_ = true;
+  }
+  checkpoint_cv_.notify_all();
+  if (checkpoint_thread_.joinable()) checkpoint_thread_.join();
+
+  // Client handlers may still be producing; anything that lands after the final checkpoint
+  // would be trusted by the next startup without ever having been flushed
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    for (auto& [key, log] : logs_) log->Close();
+  }
+
+  if (!checkpoint_recovery_points()) {
+    std::cerr << "Final checkpoint failed, next startup will run full recovery" << std::endl;
+    return;
+  }
+
+  int fd = open((log_dir_ / clean_shutdown_file).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || fsync(fd) != 0) {
+    std::cerr << "Failed to write clean shutdown marker" << std::endl;
+    if (fd >= 0) {
+      close(fd);
+      unlink((log_dir_ / clean_shutdown_file).c_str());
+    }
+    return;
+  }
+  close(fd);
+  std::cerr << "Clean shutdown complete" << std::endl;
+}
+
+// Reads Kafka's checkpoint format: version line, entry count, then "<topic> <partition> <offset>" lines
+std::map<std::string, int64_t> LogManager::read_recovery_points() const {
+  std::map<std::string, int64_t> recovery_points;
+  std::ifstream file(log_dir_ / recovery_point_file);
+  if (!file.is_open()) return recovery_points;
+
+  int version = -1;
+  size_t count = 0;
+  if (!(file >> version >> count) || version != 0) {
+    std::cerr << "Ignoring malformed recovery point checkpoint" << std::endl;
+    return recovery_points;
+  }
+
+  std::string topic;
+  int32_t partition;
+  int64_t offset;
+  while (recovery_points.size() < count && file >> topic >> partition >> offset) {
+    recovery_points[topic + "-" + std::to_string(partition)] = offset;
+  }
+  return recovery_points;
+}
+
+bool LogManager::checkpoint_recovery_points() {
+  std::map<std::string, std::shared_ptr<PartitionLog>> logs;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    logs = logs_;
+  }
+
+  // A log that failed to sync keeps its previous recovery point, but the checkpoint as a
+  // whole fails so Shutdown() won't vouch for unsynced data with the clean-shutdown marker
+  bool flushed = true;
+  std::string content = "0\n" + std::to_string(logs.size()) + "\n";
+  for (const auto& [key, log] : logs) {
+    int64_t recovery_point = log->Flush();
+    if (recovery_point < 0) {
+      flushed = false;
+      recovery_point = log->GetRecoveryPoint();
+    }
+    size_t dash = key.rfind('-');
+    content += key.substr(0, dash) + " " + key.substr(dash + 1) + " " + std::to_string(recovery_point) + "\n";
+  }
+
+  // Write-then-rename so a crash mid-checkpoint leaves the previous one intact
+  std::filesystem::path tmp_path = log_dir_ / (std::string(recovery_point_file) + ".tmp");
+  int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    std::cerr << "Failed to open " << tmp_path << std::endl;
+    return false;
+  }
+  bool written = WriteFully(fd, reinterpret_cast<const uint8_t*>(content.data()), content.size(), 0) && fsync(fd) == 0;
+  close(fd);
+
+  std::error_code ec;
+  if (written) std::filesystem::rename(tmp_path, log_dir_ / recovery_point_file, ec);
+  if (!written || ec) {
+    std::cerr << "Failed to write recovery point checkpoint" << std::endl;
+    return false;
+  }
+  return flushed;
+}
+
+std::shared_ptr<PartitionLog> LogManager::GetOrCreateLog(const std::string& topic, int32_t partition) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string key = topic + "-" + std::to_string(partition);
+  auto iter = logs_.find(key);
+  if (iter != logs_.end()) return iter->second;
+  if (closed_) return nullptr;
+
+  auto log = open_log(topic, partition, 0, false);
+  if (log) logs_[key] = log;
+  return log;
+}
+
+std::shared_ptr<PartitionLog> LogManager::open_log(const std::string& topic, int32_t partition,
+                                                   int64_t recovery_point, bool clean_shutdown) {
+  std::string key = topic + "-" + std::to_string(partition);
+  auto log = std::make_shared<PartitionLog>(log_dir_ / key, resolve_config(topic));
+  if (!log->Load(recovery_point, clean_shutdown)) return nullptr;
+
+  std::cerr << "Loaded log " << key << " log_start_offset=" << log->GetLogStartOffset()
+            << " log_end_offset=" << log->GetLogEndOffset() << std::endl;
+  return log;
+}
+
+std::vector<std::shared_ptr<PartitionLog>> LogManager::GetLogs() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::shared_ptr<PartitionLog>> logs;
+  for (const auto& [key, log] : logs_) logs.push_back(log);
+  return logs;
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <filesystem>
+#include "config.hpp"
+#include "metadata.hpp"
+
+struct LogConfig {
+  int64_t segment_bytes = 1073741824;  // 1 GiB
+  int64_t retention_ms = 604800000;    // 7 days, -1 = keep forever
+  int64_t retention_bytes = -1;        // -1 = no size limit
+  int64_t index_interval_bytes = 4096;
+};
+
+// One <base_offset>.log file plus its sparse <base_offset>.index
+struct LogSegment {
+  int64_t base_offset = 0;
+  int64_t next_offset = 0;     // offset following the last batch in the segment
+  int64_t size = 0;            // valid bytes in the .log file
+  int64_t max_timestamp = -1;  // largest batch max_timestamp, -1 if unknown
+  int64_t bytes_since_index = 0;
+  int log_fd = -1;
+  int index_fd = -1;
+  std::filesystem::path log_path;
+  std::filesystem::path index_path;
+};
+
+// Fixed-size prefix of a v2 record batch, everything up to the records array
+constexpr size_t batch_header_size = 61;
+
+// Append result for batches with bad framing, magic or CRC, as opposed to -1 for I/O errors
+constexpr int64_t invalid_batch = -2;
+
+class PartitionLog {
+public:
+  PartitionLog(std::filesystem::path dir, LogConfig config);
+  ~PartitionLog();
+
+  PartitionLog(const PartitionLog&) = delete;
+  PartitionLog& operator=(const PartitionLog&) = delete;
+
+  // Opens every segment in the directory, creating the first one if the log is empty.
+  // Segments wholly below recovery_point were flushed before the last checkpoint and are
+  // trusted; the rest are re-validated (framing + CRC) and truncated at the first bad batch.
+  // After a clean shutdown only the tail of the active segment is scanned.
+  bool Load(int64_t recovery_point, bool clean_shutdown);
+
+  // fsyncs everything appended since the last flush and returns the new recovery point,
+  // or -1 if a sync failed and the recovery point stayed where it was
+  int64_t Flush();
+
+  // Refuses every later append and truncation so a final Flush() covers the whole log
+  void Close();
+
+  // Assigns offsets to the record batches and writes them to the active segment.
+  // Returns the base offset of the first batch, invalid_batch or -1 on failure.
+  int64_t Append(std::vector<uint8_t>& batches);
+
+  // Appends batches replicated from the leader, keeping their offsets. The first batch
+  // must start at the log end offset. Returns the new log end offset, or -1 on failure.
+  int64_t AppendAsFollower(std::vector<uint8_t>& batches);
+
+  // Copies whole batches starting with the one containing offset, up to max_bytes (at least
+  // one batch) and never past max_offset
+  std::vector<uint8_t> Read(int64_t offset, int64_t max_offset, int32_t max_bytes) const;
+
+  // Drops every batch at or after offset
+  bool TruncateTo(int64_t offset);
+  // Deletes every segment and restarts the log empty at offset
+  bool TruncateFullyAndStartAt(int64_t offset);
+
+  // Detaches segments past retention; the caller deletes them with DeleteSegment
+  std::vector<LogSegment> CollectExpiredSegments(int64_t now_ms);
+  static void DeleteSegment(LogSegment& segment);
+
+  int64_t GetLogStartOffset() const;
+  int64_t GetLogEndOffset() const;
+  int64_t GetRecoveryPoint() const;
+  const std::filesystem::path& GetDir() const { return dir_; }
+
+private:
+  std::filesystem::path dir_;
+  LogConfig config_;
+  std::vector<LogSegment> segments_;  // ordered by base_offset, back() is active
+  int64_t recovery_point_ = 0;        // offsets below this are known to be on disk
+  bool closed_ = false;
+  mutable std::mutex mutex_;
+
+  bool open_segment(int64_t base_offset, bool truncate_index);
+  bool roll_segment();
+  bool recover_segment(LogSegment& segment, int64_t start_position, bool validate_crc);
+  int64_t last_indexed_position(LogSegment& segment);
+  int64_t lookup_position(const LogSegment& segment, int64_t offset) const;
+  int64_t append_batches(std::vector<uint8_t>& batches, bool assign_offsets);
+  void append_index_entry(LogSegment& segment, int64_t offset, int64_t position);
+};
+
+class LogManager {
+public:
+  // log_dir is the first entry of log.dirs (or log.dir), resolved once by the caller
+  LogManager(std::filesystem::path log_dir, const Config& config, const Metadata& metadata);
+
+  // Opens existing partition directories under log.dirs in parallel, using the
+  // clean-shutdown marker and recovery-point checkpoint to skip re-validating flushed data
+  void LoadLogs();
+
+  // Periodically flushes logs and checkpoints their recovery points
+  void Start();
+  // Closes every log to appends, then final flush + checkpoint and the clean-shutdown marker
+  void Shutdown();
+
+  // Returns nullptr once Shutdown() has begun
+  std::shared_ptr<PartitionLog> GetOrCreateLog(const std::string& topic, int32_t partition);
+  std::vector<std::shared_ptr<PartitionLog>> GetLogs() const;
+
+  const std::filesystem::path& GetLogDir() const { return log_dir_; }
+
+private:
+  std::filesystem::path log_dir_;
+  LogConfig defaults_;
+  Metadata metadata_;
+  std::map<std::string, std::shared_ptr<PartitionLog>> logs_;  // keyed by "<topic>-<partition>"
+  mutable std::mutex mutex_;
+  bool closed_ = false;  // guarded by mutex_
+
+  int64_t recovery_threads_;
+  int64_t checkpoint_interval_ms_;
+  std::thread checkpoint_thread_;
+  std::mutex checkpoint_mutex_;
+  std::condition_variable checkpoint_cv_;
+  bool stopping_ = false;
+
+  LogConfig resolve_config(const std::string& topic) const;
+  std::shared_ptr<PartitionLog> open_log(const std::string& topic, int32_t partition,
+                                         int64_t recovery_point, bool clean_shutdown);
+  std::map<std::string, int64_t> read_recovery_points() const;
+  bool checkpoint_recovery_points();
+};
@@ -1,11 +1,25 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cerrno>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
 #include <thread>
 #include <filesystem>
 #include <vector>
 #include "metadata.hpp"
 #include "server.hpp"
 #include "buffer.hpp"
+#include "config.hpp"
+#include "log.hpp"
+#include "cleaner.hpp"
+#include "replica.hpp"
 
 struct HeaderV0 {
   int16_t api_key;
@@ -16,7 +30,7 @@ struct HeaderV0 {
 
 class Protocol {
 public:
-  Protocol(Metadata storage) : storage_(storage) {};
+  Protocol(Metadata storage, ReplicaManager& replicas) : storage_(storage), replicas_(replicas) {};
 
   void handle_client(int client_fd){
     while (true) {
@@ -38,23 +52,31 @@ public:
       Buffer res_buf;
       build_response(req_header, req_buf, res_buf);
 
-      write(client_fd, res_buf.GetData().data(), res_buf.GetSize());
+      send(client_fd, res_buf.GetData().data(), res_buf.GetSize(), MSG_NOSIGNAL);
     }
-  close(client_fd);
   }
 
 private:
   Metadata storage_;
-  const uint32_t num_apis = 3;
+  ReplicaManager& replicas_;
+  // Fetch offset of the previous follower fetch on this connection per "<topic>-<partition>".
+  // Followers pipeline fetches and append a response only after sending the next request,
+  // so a request vouches for the offsets of the one before it, not its own.
+  std::map<std::string, int64_t> follower_fetch_offsets_;
+  const uint32_t num_apis = 4;
   const uint16_t min_version = 0;
   const uint16_t max_version = 4;
   const uint16_t api_version_key = 18;
   const uint16_t api_describe_topic_partitions = 75;
   const uint16_t api_produce_key = 0;
   const uint16_t max_api_produce = 11;
+  const uint16_t api_fetch_key = 1;
+  const uint16_t min_api_fetch = 12;
+  const uint16_t max_api_fetch = 16;
 
   struct PartitionRequest {
     int32_t partition_id = 0;
+    std::vector<uint8_t> records;
   };
 
   struct TopicRequest {
@@ -62,6 +84,21 @@ private:
     std::vector<PartitionRequest> partition_array;
   };
 
+  struct FetchPartitionRequest {
+    int32_t partition_id = 0;
+    int64_t fetch_offset = 0;
+    int64_t appended_offset = 0;  // follower fetches only, see follower_fetch_offsets_
+    int32_t partition_max_bytes = 0;
+    FetchResult result;
+  };
+
+  struct FetchTopicRequest {
+    std::string topic_name;
+    UUID topic_id {};
+    bool found = false;
+    std::vector<FetchPartitionRequest> partition_array;
+  };
+
   void read_request_header(Buffer& req, HeaderV0& dst) {
       dst.api_key = req.ReadInt16();
       dst.api_version = req.ReadInt16();
@@ -83,6 +120,13 @@ private:
       else if (src.api_key == api_produce_key) {
         build_api_produce_response(req_buf, res_buf);
       }
+      else if (src.api_key == api_fetch_key) {
+        if (src.api_version < min_api_fetch || src.api_version > max_api_fetch) {
+          build_unsupported_fetch_response(src, res_buf);
+        } else {
+          build_api_fetch_response(src, req_buf, res_buf);
+        }
+      }
       else { 
         std::cerr << "Unknown api_key: " << src.api_key << std::endl; 
       }
@@ -90,7 +134,8 @@ private:
       int32_t response_size = htonl(res_buf.GetSize() - 4);
       std::memcpy(res_buf.GetData().data(), &response_size, 4);
 
-      if (src.api_key == 18 && src.api_version > 4 || src.api_key == 0 && src.api_version > 11 || src.api_version < 0) {
+      if (src.api_key == 18 && src.api_version > 4 || src.api_key == 0 && src.api_version > 11 ||
+          src.api_key != api_fetch_key && src.api_version < 0) {
         int16_t error_code = htons(35);
         std::memcpy(res_buf.GetData().data() + 8, &error_code, 2);
       }
@@ -98,8 +143,8 @@ private:
 
   void build_api_produce_response(Buffer& req, Buffer& res) {
     req.ReadCompactString(); // Transactional ID
-    req.ReadInt16();          // Required ACKs
-    req.ReadInt32();          // Timeout
+    int16_t acks = req.ReadInt16();
+    int32_t timeout_ms = req.ReadInt32();
 
     int32_t topic_len = req.ReadUnsignedVarint();
     int32_t num_topic = (topic_len > 0) ? (topic_len - 1) : 0;
@@ -119,10 +164,9 @@ private:
         pin.partition_id = req.ReadInt32();
         int32_t record_batch_len = req.ReadUnsignedVarint() - 1; // Size of record batch not num of batch
 
-        // For simplicity, skip record batch bytes
-        int32_t skip_bytes = (record_batch_len > 0) ? record_batch_len : 0;
-        if (req.HasBytes(skip_bytes)) {
-          req.SetReadOffset(req.GetReadOffset() + skip_bytes);
+        int32_t records_bytes = (record_batch_len > 0) ? record_batch_len : 0;
+        if (req.HasBytes(records_bytes)) {
+          pin.records = req.ReadBytes(records_bytes);
         }
         req.SkipTagBuffer();
         tr.partition_array.push_back(pin);
@@ -150,8 +194,14 @@ private:
           ec = 3;
         } 
 
-        int64_t base_offset = ec == 0 ? 0 : -1;
-        int64_t log_start_offset = ec == 0 ? 0 : -1;
+        int64_t base_offset = -1;
+        int64_t log_start_offset = -1;
+        if (ec == 0) {
+          ProduceResult result = replicas_.Append(topic.topic_name, part.partition_id, part.records, acks, timeout_ms);
+          ec = result.error_code;
+          base_offset = result.base_offset;
+          log_start_offset = result.log_start_offset;
+        }
         res.WriteInt32(part.partition_id);
         res.WriteInt16(ec);
         res.WriteInt64(base_offset);
@@ -167,6 +217,167 @@ private:
     res.writeTagBuffer();
   }
 
+  // Other Fetch layouts aren't parsed at all; answer in the request's own header style
+  // with the v7+ top-level fields and no topics
+  void build_unsupported_fetch_response(const HeaderV0& src, Buffer& res) {
+    const bool flexible = src.api_version >= 12;
+    if (flexible) res.writeTagBuffer();
+    res.WriteInt32(0);  // throttle_time_ms
+    res.WriteInt16(35); // UNSUPPORTED_VERSION
+    res.WriteInt32(0);  // session_id
+    if (flexible) {
+      res.writeCompactArrayLength(0);
+      res.writeTagBuffer();
+    } else {
+      res.WriteInt32(0);
+    }
+  }
+
+  void build_api_fetch_response(const HeaderV0& src, Buffer& req, Buffer& res) {
+    const int16_t version = src.api_version;
+    int32_t replica_id = version < 15 ? req.ReadInt32() : -1; // v15+ moved it into a tagged field
+    int32_t max_wait_ms = req.ReadInt32();
+    int32_t min_bytes = req.ReadInt32();
+    int32_t max_bytes = req.ReadInt32();
+    req.ReadInt8();   // isolation_level
+    req.ReadInt32();  // session_id
+    req.ReadInt32();  // session_epoch
+
+    int32_t topic_len = req.ReadUnsignedVarint();
+    int32_t num_topic = (topic_len > 0) ? (topic_len - 1) : 0;
+
+    std::vector<FetchTopicRequest> topics;
+    topics.reserve(num_topic);
+    for (int32_t i = 0; i < num_topic; i++) {
+      FetchTopicRequest tr;
+      if (version >= 13) {
+        tr.topic_id = req.ReadUUID();
+        TopicInfo info = storage_.GetTopicInfoById(tr.topic_id);
+        tr.topic_name = info.topic_name;
+        tr.found = info.found;
+      } else {
+        tr.topic_name = req.ReadCompactString();
+        tr.found = storage_.IsTopicAvailable(tr.topic_name);
+        tr.topic_id = tr.found ? storage_.GetTopicInfo(tr.topic_name).uuid : UUID {};
+      }
+
+      int32_t partition_len = req.ReadUnsignedVarint();
+      int32_t num_part = (partition_len > 0) ? (partition_len - 1) : 0;
+      for (int32_t p = 0; p < num_part; p++) {
+        FetchPartitionRequest pin;
+        pin.partition_id = req.ReadInt32();
+        req.ReadInt32();  // current_leader_epoch
+        pin.fetch_offset = req.ReadInt64();
+        req.ReadInt32();  // last_fetched_epoch
+        req.ReadInt64();  // log_start_offset
+        pin.partition_max_bytes = req.ReadInt32();
+        req.SkipTagBuffer();
+        tr.partition_array.push_back(pin);
+      }
+      req.SkipTagBuffer();
+      topics.push_back(std::move(tr));
+    }
+    // forgotten_topics_data, rack_id and tagged fields are unused without fetch sessions
+
+    if (replica_id >= 0) {
+      for (auto& topic : topics) {
+        for (auto& part : topic.partition_array) {
+          auto iter = follower_fetch_offsets_.find(topic.topic_name + "-" + std::to_string(part.partition_id));
+          // The first fetch on a connection is always sent from the follower's real log end
+          part.appended_offset = iter == follower_fetch_offsets_.end() ? part.fetch_offset
+                                                                      : std::min(iter->second, part.fetch_offset);
+        }
+      }
+    }
+
+    // Long poll until min_bytes are available or max_wait_ms runs out. Followers also get
+    // an early answer when a high watermark moves, so they can pass it on to their readers.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(max_wait_ms);
+    while (true) {
+      uint64_t data_version = replicas_.GetDataVersion();
+      int64_t total_bytes = fetch_partitions(version, replica_id, max_bytes, topics);
+
+      // A follower with an append pending is answered right away so its next request can
+      // report the append, otherwise acks=-1 would wait out a whole long poll
+      bool high_watermark_advanced = false;
+      bool append_pending = false;
+      for (const auto& topic : topics) {
+        for (const auto& part : topic.partition_array) {
+          high_watermark_advanced |= part.result.high_watermark_advanced;
+          append_pending |= part.result.append_pending;
+        }
+      }
+
+      auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+      if (total_bytes >= min_bytes || high_watermark_advanced || append_pending || remaining.count() <= 0) break;
+      if (!replicas_.WaitForData(data_version, remaining.count())) break;
+    }
+
+    if (replica_id >= 0) {
+      for (const auto& topic : topics) {
+        for (const auto& part : topic.partition_array) {
+          if (part.result.error_code != 0) continue;
+          follower_fetch_offsets_[topic.topic_name + "-" + std::to_string(part.partition_id)] = part.fetch_offset;
+        }
+      }
+    }
+
+    res.writeTagBuffer();
+    res.WriteInt32(0);  // throttle_ms
+    res.WriteInt16(0);  // error_code
+    res.WriteInt32(0);  // session_id
+
+    res.writeCompactArrayLength(static_cast<int>(topics.size()));
+    for (auto& topic : topics) {
+      if (version >= 13) {
+        res.writeUUID(topic.topic_id);
+      } else {
+        res.writeCompactString(topic.topic_name);
+      }
+
+      res.writeCompactArrayLength(static_cast<int>(topic.partition_array.size()));
+      for (auto& part : topic.partition_array) {
+        res.WriteInt32(part.partition_id);
+        res.WriteInt16(part.result.error_code);
+        res.WriteInt64(part.result.high_watermark);
+        res.WriteInt64(part.result.high_watermark);   // last_stable_offset
+        res.WriteInt64(part.result.log_start_offset);
+        res.writeCompactArrayLength(0);               // aborted_transactions
+        res.WriteInt32(-1);                           // preferred_read_replica
+        res.writeUnsignedVarint(part.result.records.size() + 1);
+        res.writeBytes(part.result.records);
+        res.writeTagBuffer();
+      }
+      res.writeTagBuffer();
+    }
+    res.writeTagBuffer();
+  }
+
+  // Fills in every partition's result and returns the number of record bytes found
+  int64_t fetch_partitions(int16_t version, int32_t replica_id, int32_t max_bytes, std::vector<FetchTopicRequest>& topics) {
+    int64_t total_bytes = 0;
+    for (auto& topic : topics) {
+      const UUID uuid = topic.topic_id;
+      for (auto& part : topic.partition_array) {
+        part.result = FetchResult {};
+        if (!topic.found) {
+          part.result.error_code = version >= 13 ? 100 : 3; // UNKNOWN_TOPIC_ID / UNKNOWN_TOPIC_OR_PARTITION
+          continue;
+        }
+        if (!storage_.IsPartitionIndexAvailable(uuid, part.partition_id)) {
+          part.result.error_code = 3; // UNKNOWN_TOPIC_OR_PARTITION
+          continue;
+        }
+
+        int32_t budget = std::max<int32_t>(std::min<int64_t>(part.partition_max_bytes, max_bytes - total_bytes), 1);
+        part.result = replicas_.Fetch(replica_id, topic.topic_name, part.partition_id, part.fetch_offset,
+                                      part.appended_offset, budget);
+        total_bytes += part.result.records.size();
+      }
+    }
+    return total_bytes;
+  }
+
   void build_api_version_body_response(Buffer& req, Buffer& res) {
     std::string client_id = req.ReadCompactString();
     std::string client_software_version = req.ReadCompactString();
@@ -188,6 +399,10 @@ private:
     res.WriteInt16(min_version);
     res.WriteInt16(max_api_produce);
     res.writeTagBuffer();
+    res.WriteInt16(api_fetch_key);
+    res.WriteInt16(min_api_fetch);
+    res.WriteInt16(max_api_fetch);
+    res.writeTagBuffer();
 
     res.WriteInt32(0); // throttle_ms
     res.writeTagBuffer();
@@ -260,13 +475,64 @@ int main(int argc, char *argv[]) {
   std::cerr << std::unitbuf;
   std::cerr << "Logs from your program will appear here!\n";
 
-  std::filesystem::path path = "/tmp/kraft-combined-logs/__cluster_metadata-0/00000000000000000000.log";
+  // Block SIGINT/SIGTERM before any thread starts so only the waiter below receives them
+  sigset_t shutdown_signals;
+  sigemptyset(&shutdown_signals);
+  sigaddset(&shutdown_signals, SIGINT);
+  sigaddset(&shutdown_signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &shutdown_signals, nullptr);
+
+  Config config;
+  if (argc > 1) config.load(argv[1]);
+
+  // listeners=PLAINTEXT://host:port,CONTROLLER://..., only the first listener's port matters here
+  std::string listener = config.GetString("listeners", "PLAINTEXT://:9092");
+  listener = listener.substr(0, listener.find(','));
+  uint16_t port = 9092;
+  try {
+    int parsed = std::stoi(listener.substr(listener.rfind(':') + 1));
+    if (parsed <= 0 || parsed > 65535) throw std::out_of_range("port");
+    port = static_cast<uint16_t>(parsed);
+  } catch (const std::exception&) {
+    std::cerr << "Invalid port in listeners: " << listener << ", using 9092" << std::endl;
+  }
+  // Bind before touching the log dir, so a broker colliding with another one leaves its data alone
+  int server_fd = Server::createSocket(port);
+  if (server_fd < 0) return 1;
+
+  // Same precedence as Kafka: log.dirs wins over log.dir, and only the first dir is used
+  std::string log_dirs = config.GetString("log.dirs", config.GetString("log.dir", "/tmp/kraft-combined-logs"));
+  std::filesystem::path log_dir = log_dirs.substr(0, log_dirs.find(','));
+  std::filesystem::path path = log_dir / "__cluster_metadata-0" / "00000000000000000000.log";
   Metadata log_file;
   log_file.load(path);
 
-  int server_fd = Server::createSocket();
+  LogManager logs(log_dir, config, log_file);
+  logs.LoadLogs();
+  logs.Start();
+
+  LogCleaner cleaner(logs, config);
+  cleaner.Start();
+
+  ReplicaManager replicas(config, log_file, logs);
+  replicas.Start();
 
-  while (true) {
+  std::atomic<bool> stopping = false;
+  std::thread signal_thread([&shutdown_signals, &stopping, server_fd]() {
+    int sig;
+    sigwait(&shutdown_signals, &sig);
+    std::cerr << "Received signal " << sig << ", shutting down\n";
+    stopping = true;
+    shutdown(server_fd, SHUT_RDWR); // wakes up accept()
+  });
+
+  // Client handlers are detached but registered here, so shutdown can disconnect them and
+  // wait for them before tearing down the objects they use
+  std::mutex clients_mutex;
+  std::condition_variable clients_cv;
+  std::set<int> client_fds;
+
+  while (!stopping) {
     struct sockaddr_in client_addr {};
 
     socklen_t client_addr_len = sizeof(client_addr);
@@ -274,11 +540,46 @@ int main(int argc, char *argv[]) {
     int client_fd =
         accept(server_fd, reinterpret_cast<struct sockaddr *>(&client_addr),
                &client_addr_len);
+    if (client_fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      if (!stopping) std::cerr << "accept failed: " << std::strerror(errno) << std::endl;
+      break;
+    }
     std::cout << "Client connected\n";
 
-    std::thread([client_fd, log_file]() { Protocol conn(log_file); conn.handle_client(client_fd); }).detach();
+    {
+      std::lock_guard<std::mutex> lock(clients_mutex);
+      client_fds.insert(client_fd);
+    }
+    std::thread([client_fd, log_file, &replicas, &clients_mutex, &clients_cv, &client_fds]() {
+      {
+        Protocol conn(log_file, replicas);
+        conn.handle_client(client_fd);
+      }
+      // Unregister before closing so shutdown never touches a reused fd number
+      std::lock_guard<std::mutex> lock(clients_mutex);
+      client_fds.erase(client_fd);
+      close(client_fd);
+      clients_cv.notify_all();
+    }).detach();
+  }
+
+  if (!stopping) pthread_kill(signal_thread.native_handle(), SIGTERM);
+  signal_thread.join();
+
+  // Disconnect clients and release the ones parked in a long poll or acks=-1 wait
+  {
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    for (int fd : client_fds) shutdown(fd, SHUT_RDWR);
+  }
+  replicas.Stop();
+  {
+    std::unique_lock<std::mutex> lock(clients_mutex);
+    clients_cv.wait(lock, [&client_fds]() { return client_fds.empty(); });
   }
 
+  cleaner.Stop();
+  logs.Shutdown();
   close(server_fd);
 
   return 0;
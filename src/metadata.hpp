@@ -47,6 +47,13 @@ public:
     return iter->second;
   }
 
+  TopicInfo GetTopicInfoById(const UUID& id) const {
+    for (const auto& [name, info] : topics_) {
+      if (info.uuid == id) return info;
+    }
+    return {};
+  }
+
   std::vector<PartitionInfo> GetPartitionInfo(const UUID& id) const {
     auto iter = partitions_.find(id);
     if (iter == partitions_.end()) {
@@ -70,12 +77,24 @@ public:
     return iter_id != parts.end();
   }
 
+  const std::map<std::string, TopicInfo>& GetTopics() const { return topics_; }
+
+  // Per-topic overrides (retention.ms, retention.bytes, ...) from ConfigRecords
+  std::map<std::string, std::string> GetTopicConfig(const std::string& topic_name) const {
+    auto iter = topic_configs_.find(topic_name);
+    if (iter == topic_configs_.end()) return {};
+    return iter->second;
+  }
+
 private:
   const uint8_t topic_record_type_ = 2;
   const uint8_t partitions_record_type_ = 3;
+  const uint8_t config_record_type_ = 4;
+  const int8_t topic_resource_type_ = 2;
 
   std::map<std::string, TopicInfo> topics_;
   std::map<UUID, std::vector<PartitionInfo>> partitions_;
+  std::map<std::string, std::map<std::string, std::string>> topic_configs_;
 
   std::vector<uint8_t> ReadFile(std::filesystem::path& path) {
     std::ifstream file(path, std::ios::binary | std::ios::ate);
@@ -187,6 +206,24 @@ private:
 
           partitions_[topic_uuid].push_back(partition_info);
         }
+        else if (type == config_record_type_) {
+          (void)buf.ReadInt8(); // version
+          int8_t resource_type      = buf.ReadInt8();
+          std::string resource_name = buf.ReadCompactString();
+          std::string config_name   = buf.ReadCompactString();
+          std::string config_value  = buf.ReadCompactString(); // null value = config deleted
+
+          if (resource_type == topic_resource_type_) {
+            if (config_value.empty()) {
+              topic_configs_[resource_name].erase(config_name);
+            } else {
+              topic_configs_[resource_name][config_name] = config_value;
+            }
+          }
+
+          buf.SkipTagBuffer();      // record-level tag buffer
+          buf.ReadUnsignedVarint(); // headers array
+        }
         else {
           // Unknown record type: skip to next batch boundary to stay safe
           std::cerr << "Unknown record type " << static_cast<int>(type)
@@ -0,0 +1,334 @@
+#include "replica.hpp"
+#include "fetcher.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+int64_t NowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// broker.endpoints uses the controller.quorum.voters syntax: <id>@<host>:<port>,...
+std::map<int32_t, BrokerEndpoint> ParseEndpoints(const std::string& value) {
+  std::map<int32_t, BrokerEndpoint> endpoints;
+  std::stringstream stream(value);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    size_t at = item.find('@');
+    size_t colon = item.rfind(':');
+    if (at == std::string::npos || colon == std::string::npos || colon < at) {
+      std::cerr << "Ignoring malformed broker endpoint " << item << std::endl;
+      continue;
+    }
+    try {
+      BrokerEndpoint endpoint;
+      endpoint.node_id = std::stoi(item.substr(0, at));
+      endpoint.host = item.substr(at + 1, colon - at - 1);
+      endpoint.port = static_cast<uint16_t>(std::stoi(item.substr(colon + 1)));
+      endpoints[endpoint.node_id] = endpoint;
+    } catch (const std::exception&) {
+      std::cerr << "Ignoring malformed broker endpoint " << item << std::endl;
+    }
+  }
+  return endpoints;
+}
+
+} // namespace
+
+ReplicaManager::ReplicaManager(const Config& config, const Metadata& metadata, LogManager& logs)
+    : config_(config), metadata_(metadata), logs_(logs) {
+  node_id_ = static_cast<int32_t>(config.GetInt64("node.id", config.GetInt64("broker.id", 1)));
+  replica_lag_time_max_ms_ = config.GetInt64("replica.lag.time.max.ms", 30000);
+  min_insync_replicas_ = config.GetInt64("min.insync.replicas", 1);
+
+  peers_ = ParseEndpoints(config.GetString("broker.endpoints", ""));
+  peers_.erase(node_id_);
+}
+
+ReplicaManager::~ReplicaManager() {
+  Stop();
+}
+
+void ReplicaManager::Start() {
+  if (peers_.empty()) return;
+
+  std::map<int32_t, std::vector<std::shared_ptr<Partition>>> followed;
+  for (const auto& [name, topic] : metadata_.GetTopics()) {
+    for (const auto& info : metadata_.GetPartitionInfo(topic.uuid)) {
+      if (info.leader_id == node_id_) continue;
+      if (std::find(info.replica_nodes.begin(), info.replica_nodes.end(), node_id_) == info.replica_nodes.end()) continue;
+
+      int16_t error_code;
+      auto partition = get_partition(name, info.partition_id, error_code);
+      if (!partition) continue;
+      if (peers_.find(info.leader_id) == peers_.end()) {
+        std::cerr << "No endpoint for leader " << info.leader_id << " of " << name << "-" << info.partition_id << std::endl;
+        continue;
+      }
+      followed[info.leader_id].push_back(partition);
+    }
+  }
+
+  for (auto& [leader_id, partitions] : followed) {
+    std::cerr << "Following " << partitions.size() << " partitions from broker " << leader_id << std::endl;
+    fetchers_.push_back(std::make_unique<ReplicaFetcher>(*this, peers_[leader_id], partitions, config_));
+    fetchers_.back()->Start();
+  }
+}
+
+void ReplicaManager::Stop() {
+  for (auto& fetcher : fetchers_) fetcher->Stop();
+  fetchers_.clear();
+
+  // Release client handlers parked in a long poll or an acks=-1 wait
+  {
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    stopping_ = true;
+  }
+  data_cv_.notify_all();
+
+  std::vector<std::shared_ptr<Partition>> partitions;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& [key, partition] : partitions_) partitions.push_back(partition);
+  }
+  for (auto& partition : partitions) {
+    // Taking the lock orders this after any waiter that saw stopping_ still false
+    std::lock_guard<std::mutex> lock(partition->mutex);
+    partition->high_watermark_cv.notify_all();
+  }
+}
+
+std::shared_ptr<Partition> ReplicaManager::get_partition(const std::string& topic, int32_t partition_id,
+                                                         int16_t& error_code) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  error_code = 0;
+  std::string key = topic + "-" + std::to_string(partition_id);
+  auto iter = partitions_.find(key);
+  if (iter != partitions_.end()) return iter->second;
+
+  auto partition = std::make_shared<Partition>();
+  partition->topic = topic;
+  partition->partition_id = partition_id;
+  partition->leader_id = node_id_;
+  partition->leader_epoch = 0;
+  partition->replicas = {node_id_};
+
+  if (!peers_.empty()) {
+    std::vector<PartitionInfo> infos = metadata_.GetPartitionInfo(metadata_.GetTopicInfo(topic).uuid);
+    auto info = std::find_if(infos.begin(), infos.end(), [&](const PartitionInfo& p) {
+      return p.partition_id == partition_id;
+    });
+    if (info == infos.end()) {
+      error_code = 3; // UNKNOWN_TOPIC_OR_PARTITION
+      return nullptr;
+    }
+    // Never create a log for a partition this broker isn't assigned
+    if (std::find(info->replica_nodes.begin(), info->replica_nodes.end(), node_id_) == info->replica_nodes.end()) {
+      error_code = 6; // NOT_LEADER_OR_FOLLOWER
+      return nullptr;
+    }
+    partition->leader_id = info->leader_id;
+    partition->leader_epoch = info->leader_epoch;
+    partition->replicas = info->replica_nodes;
+  }
+
+  partition->log = logs_.GetOrCreateLog(topic, partition_id);
+  if (!partition->log) {
+    error_code = 56; // KAFKA_STORAGE_ERROR
+    return nullptr;
+  }
+
+  // Start with every reachable replica in sync; ones that never fetch drop out after the lag time
+  int64_t now_ms = NowMs();
+  for (int32_t replica : partition->replicas) {
+    if (replica == node_id_) {
+      partition->isr.insert(replica);
+    } else if (peers_.find(replica) != peers_.end()) {
+      partition->isr.insert(replica);
+      partition->followers[replica].last_caught_up_ms = now_ms;
+    }
+  }
+  if (partition->leader_id == node_id_ && partition->isr.size() == 1) {
+    partition->high_watermark = partition->log->GetLogEndOffset();
+  }
+
+  partitions_[key] = partition;
+  return partition;
+}
+
+// Caller holds partition.mutex. Drops lagging followers from the ISR and moves the high
+// watermark up to the smallest log end offset among the remaining in-sync replicas.
+void ReplicaManager::update_high_watermark(Partition& partition, int64_t now_ms) {
+  if (partition.leader_id != node_id_) return;
+
+  int64_t high_watermark = partition.log->GetLogEndOffset();
+  for (auto iter = partition.isr.begin(); iter != partition.isr.end();) {
+    if (*iter == node_id_) {
+      ++iter;
+      continue;
+    }
+
+    const FollowerState& follower = partition.followers[*iter];
+    if (now_ms - follower.last_caught_up_ms > replica_lag_time_max_ms_) {
+      std::cerr << "Shrinking ISR of " << partition.topic << "-" << partition.partition_id
+                << ": removing lagging replica " << *iter << std::endl;
+      iter = partition.isr.erase(iter);
+      continue;
+    }
+    high_watermark = std::min(high_watermark, follower.log_end_offset);
+    ++iter;
+  }
+
+  if (high_watermark > partition.high_watermark) {
+    partition.high_watermark = high_watermark;
+    partition.high_watermark_cv.notify_all();
+    notify_data();
+  }
+}
+
+ProduceResult ReplicaManager::Append(const std::string& topic, int32_t partition_id, std::vector<uint8_t>& records,
+                                     int16_t acks, int32_t timeout_ms) {
+  ProduceResult result;
+  auto partition = get_partition(topic, partition_id, result.error_code);
+  if (!partition) return result;
+  if (partition->leader_id != node_id_) {
+    result.error_code = 6; // NOT_LEADER_OR_FOLLOWER
+    return result;
+  }
+
+  std::unique_lock<std::mutex> lock(partition->mutex);
+  update_high_watermark(*partition, NowMs());
+  if (acks == -1 && static_cast<int64_t>(partition->isr.size()) < min_insync_replicas_) {
+    result.error_code = 19; // NOT_ENOUGH_REPLICAS
+    return result;
+  }
+
+  result.base_offset = partition->log->Append(records);
+  if (result.base_offset < 0) {
+    result.error_code = result.base_offset == invalid_batch ? 2 : 56; // CORRUPT_MESSAGE / KAFKA_STORAGE_ERROR
+    result.base_offset = -1;
+    return result;
+  }
+  result.log_start_offset = partition->log->GetLogStartOffset();
+  const int64_t log_end_offset = partition->log->GetLogEndOffset();
+  notify_data();
+  update_high_watermark(*partition, NowMs());
+
+  if (acks != -1) return result;
+
+  // Wake up periodically so a dead follower is dropped from the ISR instead of stalling us
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (partition->high_watermark < log_end_offset) {
+    if (stopping_ || std::chrono::steady_clock::now() >= deadline) {
+      result.error_code = 7; // REQUEST_TIMED_OUT
+      return result;
+    }
+    auto wake = std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(100));
+    partition->high_watermark_cv.wait_until(lock, wake);
+    update_high_watermark(*partition, NowMs());
+  }
+  return result;
+}
+
+FetchResult ReplicaManager::Fetch(int32_t replica_id, const std::string& topic, int32_t partition_id,
+                                  int64_t fetch_offset, int64_t appended_offset, int32_t max_bytes) {
+  FetchResult result;
+  auto partition = get_partition(topic, partition_id, result.error_code);
+  if (!partition) return result;
+
+  std::lock_guard<std::mutex> lock(partition->mutex);
+  const bool is_follower = replica_id >= 0;
+  if (is_follower && (partition->leader_id != node_id_ || partition->followers.find(replica_id) == partition->followers.end())) {
+    result.error_code = 6; // NOT_LEADER_OR_FOLLOWER
+    return result;
+  }
+
+  const int64_t log_end_offset = partition->log->GetLogEndOffset();
+  result.log_start_offset = partition->log->GetLogStartOffset();
+  result.high_watermark = partition->high_watermark;
+  if (fetch_offset < result.log_start_offset || fetch_offset > log_end_offset) {
+    result.error_code = 1; // OFFSET_OUT_OF_RANGE
+    return result;
+  }
+
+  if (is_follower) {
+    // A pipelined fetch_offset may cover records still in flight to the follower; only
+    // appended_offset is known to be in its log
+    int64_t now_ms = NowMs();
+    FollowerState& follower = partition->followers[replica_id];
+    follower.log_end_offset = appended_offset;
+    result.append_pending = appended_offset < fetch_offset;
+    if (appended_offset >= log_end_offset) {
+      follower.last_caught_up_ms = now_ms;
+    } else if (appended_offset >= follower.last_fetch_leader_log_end_offset) {
+      follower.last_caught_up_ms = std::max(follower.last_caught_up_ms, follower.last_fetch_ms);
+    }
+    follower.last_fetch_ms = now_ms;
+    follower.last_fetch_leader_log_end_offset = log_end_offset;
+
+    if (partition->isr.count(replica_id) == 0 && appended_offset >= partition->high_watermark) {
+      std::cerr << "Expanding ISR of " << topic << "-" << partition_id << ": adding replica " << replica_id << std::endl;
+      partition->isr.insert(replica_id);
+    }
+    update_high_watermark(*partition, now_ms);
+    result.high_watermark = partition->high_watermark;
+    result.high_watermark_advanced = result.high_watermark > follower.last_sent_high_watermark;
+    follower.last_sent_high_watermark = result.high_watermark;
+  }
+
+  int64_t max_offset = is_follower ? log_end_offset : partition->high_watermark;
+  result.records = partition->log->Read(fetch_offset, max_offset, max_bytes);
+  return result;
+}
+
+uint64_t ReplicaManager::GetDataVersion() {
+  std::lock_guard<std::mutex> lock(data_mutex_);
+  return data_version_;
+}
+
+bool ReplicaManager::WaitForData(uint64_t seen_version, int64_t max_wait_ms) {
+  std::unique_lock<std::mutex> lock(data_mutex_);
+  data_cv_.wait_for(lock, std::chrono::milliseconds(max_wait_ms),
+                    [&]() { return stopping_ || data_version_ != seen_version; });
+  return !stopping_;
+}
+
+void ReplicaManager::notify_data() {
+  {
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    data_version_++;
+  }
+  data_cv_.notify_all();
+}
+
+int64_t ReplicaManager::AppendAsFollower(Partition& partition, std::vector<uint8_t>& records, int64_t leader_high_watermark) {
+  std::lock_guard<std::mutex> lock(partition.mutex);
+  int64_t log_end_offset = partition.log->AppendAsFollower(records);
+  if (log_end_offset < 0) return -1;
+
+  int64_t high_watermark = std::min(leader_high_watermark, log_end_offset);
+  if (!records.empty() || high_watermark > partition.high_watermark) {
+    partition.high_watermark = std::max(partition.high_watermark, high_watermark);
+    notify_data();
+  }
+  return log_end_offset;
+}
+
+void ReplicaManager::HandleOffsetOutOfRange(Partition& partition, int64_t leader_log_start_offset, int64_t leader_high_watermark) {
+  std::lock_guard<std::mutex> lock(partition.mutex);
+  int64_t log_end_offset = partition.log->GetLogEndOffset();
+
+  if (log_end_offset < leader_log_start_offset) {
+    // The leader already deleted what we'd fetch next, start over at its log start
+    partition.log->TruncateFullyAndStartAt(leader_log_start_offset);
+  } else {
+    // We're ahead of the leader, drop what it never committed
+    partition.log->TruncateTo(leader_high_watermark);
+  }
+  partition.high_watermark = std::min(partition.high_watermark, partition.log->GetLogEndOffset());
+}
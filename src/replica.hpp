@@ -0,0 +1,119 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "config.hpp"
+#include "log.hpp"
+#include "metadata.hpp"
+
+struct BrokerEndpoint {
+  int32_t node_id;
+  std::string host;
+  uint16_t port;
+};
+
+// What the leader knows about one follower's progress
+struct FollowerState {
+  int64_t log_end_offset = -1;
+  int64_t last_caught_up_ms = 0;
+  int64_t last_fetch_ms = 0;
+  int64_t last_fetch_leader_log_end_offset = -1;
+  int64_t last_sent_high_watermark = -1;
+};
+
+// Replication state of one partition hosted on this broker
+struct Partition {
+  std::string topic;
+  int32_t partition_id;
+  int32_t leader_id;
+  int32_t leader_epoch;
+  std::vector<int32_t> replicas;
+  std::shared_ptr<PartitionLog> log;
+
+  std::mutex mutex;
+  std::condition_variable high_watermark_cv;
+  int64_t high_watermark = 0;
+  std::set<int32_t> isr;
+  std::map<int32_t, FollowerState> followers;  // only populated on the leader
+};
+
+struct ProduceResult {
+  int16_t error_code = 0;
+  int64_t base_offset = -1;
+  int64_t log_start_offset = -1;
+};
+
+struct FetchResult {
+  int16_t error_code = 0;
+  int64_t high_watermark = -1;
+  int64_t log_start_offset = -1;
+  bool high_watermark_advanced = false;  // follower fetch: newer than the last one we reported
+  bool append_pending = false;           // follower fetch: fetch_offset is past what it has appended
+  std::vector<uint8_t> records;
+};
+
+class ReplicaFetcher;
+
+// Leader and follower side of partition replication between brokers listed in
+// broker.endpoints. Without peers every partition is led locally by a single replica.
+class ReplicaManager {
+public:
+  ReplicaManager(const Config& config, const Metadata& metadata, LogManager& logs);
+  ~ReplicaManager();
+
+  // Starts one fetcher per leader this broker follows partitions from
+  void Start();
+  // Stops the fetchers and wakes every long poll and acks=-1 wait for good
+  void Stop();
+
+  int32_t GetNodeId() const { return node_id_; }
+
+  // acks=-1 blocks until the in-sync replicas have the records or timeout_ms passes
+  ProduceResult Append(const std::string& topic, int32_t partition_id, std::vector<uint8_t>& records,
+                       int16_t acks, int32_t timeout_ms);
+
+  // replica_id >= 0 marks a follower fetch, which reads up to the log end and advances
+  // that follower's replication state to appended_offset, the part of its log it vouches
+  // for; consumers only see records below the high watermark
+  FetchResult Fetch(int32_t replica_id, const std::string& topic, int32_t partition_id,
+                    int64_t fetch_offset, int64_t appended_offset, int32_t max_bytes);
+
+  // Long-poll support: the version bumps whenever records are appended or a high watermark moves.
+  // WaitForData returns false once Stop() was called.
+  uint64_t GetDataVersion();
+  bool WaitForData(uint64_t seen_version, int64_t max_wait_ms);
+
+  // Follower side, driven by ReplicaFetcher
+  int64_t AppendAsFollower(Partition& partition, std::vector<uint8_t>& records, int64_t leader_high_watermark);
+  void HandleOffsetOutOfRange(Partition& partition, int64_t leader_log_start_offset, int64_t leader_high_watermark);
+
+private:
+  int32_t node_id_;
+  std::map<int32_t, BrokerEndpoint> peers_;
+  int64_t replica_lag_time_max_ms_;
+  int64_t min_insync_replicas_;
+  Config config_;
+  Metadata metadata_;
+  LogManager& logs_;
+
+  std::map<std::string, std::shared_ptr<Partition>> partitions_;  // keyed by "<topic>-<partition>"
+  std::mutex mutex_;
+
+  std::mutex data_mutex_;
+  std::condition_variable data_cv_;
+  uint64_t data_version_ = 0;
+  std::atomic<bool> stopping_ = false;  // written under data_mutex_
+
+  std::vector<std::unique_ptr<ReplicaFetcher>> fetchers_;
+
+  // nullptr with error_code set when the partition is unknown, not assigned here, or its log can't be opened
+  std::shared_ptr<Partition> get_partition(const std::string& topic, int32_t partition_id, int16_t& error_code);
+  void update_high_watermark(Partition& partition, int64_t now_ms);
+  void notify_data();
+};
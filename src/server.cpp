@@ -2,7 +2,7 @@
 #include <unistd.h>
 #include <iostream>
 
-int Server::createSocket() {
+int Server::createSocket(uint16_t port) {
   int server_fd = socket(AF_INET, SOCK_STREAM, 0);
   if (server_fd < 0) {
     std::cerr << "Failed to create server socket: " << std::endl;
@@ -20,12 +20,12 @@ int Server::createSocket() {
   struct sockaddr_in server_addr{};
   server_addr.sin_family = AF_INET;
   server_addr.sin_addr.s_addr = INADDR_ANY;
-  server_addr.sin_port = htons(9092);
+  server_addr.sin_port = htons(port);
 
   if (bind(server_fd, reinterpret_cast<struct sockaddr *>(&server_addr),
             sizeof(server_addr)) != 0) {
     close(server_fd);
-    std::cerr << "Failed to bind to port 9092" << std::endl;
+    std::cerr << "Failed to bind to port " << port << std::endl;
     return -1;
   }
 
@@ -41,3 +41,30 @@ int Server::createSocket() {
   return server_fd;
 };
 
+int Server::connectTo(const std::string& host, uint16_t port) {
+  struct addrinfo hints{};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  struct addrinfo* addrs = nullptr;
+  std::string service = std::to_string(port);
+  if (getaddrinfo(host.c_str(), service.c_str(), &hints, &addrs) != 0) {
+    std::cerr << "Failed to resolve " << host << std::endl;
+    return -1;
+  }
+
+  int fd = -1;
+  for (struct addrinfo* addr = addrs; addr != nullptr; addr = addr->ai_next) {
+    fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    if (fd < 0) continue;
+    if (connect(fd, addr->ai_addr, addr->ai_addrlen) == 0) break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addrs);
+
+  if (fd < 0) {
+    std::cerr << "Failed to connect to " << host << ":" << port << std::endl;
+  }
+  return fd;
+}
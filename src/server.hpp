@@ -4,9 +4,12 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <cstdint>
+#include <string>
 
 class Server {
 public:
-  static int createSocket();
+  static int createSocket(uint16_t port);
+  static int connectTo(const std::string& host, uint16_t port);
 };
 